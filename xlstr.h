@@ -3,9 +3,24 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <climits>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if __cplusplus >= 202002L
+#include <compare>
+#endif
 
 
 
@@ -18,7 +33,8 @@
 # Generally, an xlstr is immutable once instantiated.
 # Methods associated with xlstr implement C functions such as malloc, realloc and free,
 and almost always returns a new xlstr.
-# Only the operators += and *= modifies the xlstr itself, as a way to speed up the operation.
+# Only the operators += and *= modify the contents of an xlstr, as a way to speed up the operation.
+# The swap method, and the sort method of xl_str_collection which is built on it, exchange contents between xlstrs by swapping their char pointers, without modifying any content.
 # The xlstr class implements the most common str methods in Javascript, whereas operator overloads allows user to write codes similar to Python. The class and its methods are meant provide an extra level of abstraction that hides the details of memory allocations and deallocations from the user.
 
 < Communication betwen str and substr arrays >
@@ -40,7 +56,50 @@ and almost always returns a new xlstr.
 <[ xlstr_collection ]>
 
 # A dedicated wrapper to support JavaScript-style split and zip operations for strs.
-# Essentially an inherited class from std::vector<xl_str>, with one only extra implementation, the zip method, which concatenates a list of xlstrs.
+# Essentially an inherited class from std::vector<xl_str>, with the zip method, which concatenates a list of xlstrs, and the sort and argsort methods.
+
+< Sorting >
+# xlstrs are ordered by the compare method, which gives the same order as strcmp, and by operator<=> (C++20) or the relational operators (earlier standards).
+# The sort method orders the collection with a multikey quicksort on the characters of the strs, which never compares a common prefix twice.
+# Only an array of pointers is sorted, and the resulting permutation is applied by swapping the char pointers of the xlstrs, so no str content is copied or reallocated.
+# The argsort method returns the sorted order as an array of indices instead, and leaves the collection untouched.
+
+
+
+<[ xlstr_matcher ]>
+
+# A precompiled pattern for Levenshtein distances and approximate searches, using Myers' bit-parallel algorithm.
+# The pattern is encoded once into bitmasks of 64 rows per machine word, and each text character then updates a whole column of the edit distance matrix in O(m / 64) word operations, without any DP matrix.
+# Patterns longer than 64 characters are split into blocks of 64 rows that carry the horizontal deltas from one block to the next (Hyyro's multi-word extension).
+# The distance methods take an optional maxdist and return -1 as soon as the distance is proven to exceed it.
+# The distances method scores a whole xl_str_collection against the pattern, sharing the delta vectors between candidates so that no memory is allocated per candidate.
+# The delta vectors live on the stack for patterns of up to 64 characters, and in a caller-owned workspace, or a temporary one per call, for longer patterns. A matcher is never modified after construction, so it can be shared by multiple threads, each with its own workspace.
+# The xlstr methods distance and fuzzy_indexof are shortcuts that build a temporary matcher for a single comparison.
+
+
+
+<[ xlstr_collection files ]>
+
+# The save method of xl_str_collection writes the collection to a compact binary file, which xl_str_mapped_collection opens without rebuilding any xlstr.
+# Layout: a 40-byte header (magic "XLSTRCOL", version, flags, element count, blob size, checksum), an array of count + 1 uint64 offsets, and one contiguous blob.
+# Element i occupies blob[offsets[i], offsets[i + 1]) including its ending '\0', so every element is a valid C-style str in place.
+# The optional checksum is FNV-1a over the offsets array and the blob. Integers are stored in native byte order, so files are meant to be read on the machine type that wrote them.
+# On POSIX systems the file is mapped with mmap, so opening costs the same regardless of the element count and pages are only read when elements are accessed. Elsewhere the file is read into a single buffer.
+# The xl_file_map helper that maps files is also available on its own.
+
+
+
+<[ xlstr_index ]>
+
+# An optional index built once over a large xlstr, to answer many substr queries without scanning the xlstr each time.
+# Consists of the suffix array, built in linear time with SA-IS (Nong, Zhang and Chan), and the LCP array, built with Kasai's algorithm.
+# includes, indexof, lastindexof, count and findall binary search the suffix array in O(m log n) for a pattern of length m; findall then also visits every occurrence.
+# indexof and lastindexof take the minimum and maximum of the suffix array over the matching range in O(1), from sparse tables over blocks of 32 entries plus scans of the partial blocks at either end. Each table holds (n / 32) log2(n / 32) ints, a little over half of n for texts of millions of characters, instead of the n log2 n of a sparse table over every entry.
+# The binary searches skip the prefix already known to match both ends of the search range, so in practice most characters of the pattern are compared only once.
+# With more than one thread, the LCP array is computed in parallel chunks; SA-IS itself is sequential.
+# An index can be saved to a file and loaded back, mapped like xl_str_mapped_collection, together with the same xlstr. The file carries an FNV-1a checksum over its arrays, which load checks on request.
+# The index keeps a pointer to the xlstr's contents, so the xlstr must outlive the index and must not be modified with += or *= in the meantime.
+# Positions are stored as 32-bit ints, which limits the xlstr to INT_MAX - 1 characters.
 
 */
 
@@ -48,9 +107,19 @@ and almost always returns a new xlstr.
 
 // DECLARATIONS OF RELEVANT CLASSES.
 class xl_str;
+class xl_str_matcher;
+class xl_str_mapped_collection;
+class xl_str_index;
 class xl_str_collection : public std::vector<xl_str> {
+	struct sortentry;
+	static void cachekeys(sortentry *, size_t, size_t);
+	static void sortentries(sortentry *, size_t, size_t);
+	static void sortcachedentries(sortentry *, size_t, size_t);
 public:
 	xl_str zip(const char *) const;
+	void sort();
+	std::vector<size_t> argsort() const;
+	bool save(const char *, bool = true) const;
 };
 
 
@@ -220,6 +289,52 @@ public:
 		return strcmp(this->str, xlstr2()) != 0;
 	}
 
+	// Compares the current xlstr with str2 in lexicographical order of unsigned characters, consistent with strcmp.
+	// Returns a negative value, zero or a positive value if the current xlstr is less than, equal to or greater than str2.
+	// The first characters are compared inline, since most unequal strs already differ there; otherwise strcmp stops at the first difference.
+	// Provides overload for C-str and xlstr.
+	int compare(const char *str2) const {
+		unsigned char firstchar = (unsigned char)this->str[0];
+		unsigned char firstchar2 = (unsigned char)str2[0];
+		if (firstchar != firstchar2) return firstchar < firstchar2 ? -1 : 1;
+		int cmp = strcmp(this->str, str2);
+		return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+	}
+	int compare(const xl_str& xlstr2) const {
+		return this->compare(xlstr2());
+	}
+
+#ifdef __cpp_lib_three_way_comparison
+	// Three-way comparison in the same order as the compare method.
+	// The relational operators <, <=, > and >= are synthesized from it, so xlstrs can be used with std::sort, std::map and binary searches.
+	// Provides overload for C-str and xlstr.
+	std::strong_ordering operator<=>(const char *str2) const {
+		return this->compare(str2) <=> 0;
+	}
+	std::strong_ordering operator<=>(const xl_str& xlstr2) const {
+		return this->compare(xlstr2()) <=> 0;
+	}
+#else
+	// Relational operators in the same order as the compare method, for standards before C++20.
+	// Provides overload for C-str and xlstr.
+	bool operator<(const char *str2) const { return this->compare(str2) < 0; }
+	bool operator<(const xl_str& xlstr2) const { return this->compare(xlstr2()) < 0; }
+	bool operator<=(const char *str2) const { return this->compare(str2) <= 0; }
+	bool operator<=(const xl_str& xlstr2) const { return this->compare(xlstr2()) <= 0; }
+	bool operator>(const char *str2) const { return this->compare(str2) > 0; }
+	bool operator>(const xl_str& xlstr2) const { return this->compare(xlstr2()) > 0; }
+	bool operator>=(const char *str2) const { return this->compare(str2) >= 0; }
+	bool operator>=(const xl_str& xlstr2) const { return this->compare(xlstr2()) >= 0; }
+#endif
+
+	// Exchanges the contents of two xlstrs by swapping their char pointers, without copying the str contents.
+	// Also found by std::swap-based algorithms through the non-member swap below.
+	void swap(xl_str& xlstr2) {
+		char *tmpstr = this->str;
+		this->str = xlstr2.str;
+		xlstr2.str = tmpstr;
+	}
+
 	// Returns the size of the xlstr's character contents excluding the ending '\0'.
 	size_t size() const {
 		return strlen(this->str);
@@ -341,6 +456,15 @@ public:
 		return newxlstr;
 	}
 
+	// Returns the Levenshtein distance between the current xlstr and str2, i.e. the minimum number of single-character insertions, deletions and substitutions that turns one into the other.
+	// If maxdist is given, returns -1 instead once the distance is known to exceed maxdist.
+	// The shorter of the two strs is used as the pattern of an xl_str_matcher. To compare against many candidates, build the xl_str_matcher once instead.
+	// Provides overload for C-str and xlstr.
+	size_t distance(const char *str2) const;
+	size_t distance(const xl_str& xlstr2) const;
+	ptrdiff_t distance(const char *str2, size_t maxdist) const;
+	ptrdiff_t distance(const xl_str& xlstr2, size_t maxdist) const;
+
 	// Determine if the current xlstr ends with the substr.
 	// Provides overload for C-str and xlstr.
 	bool endswith(const char *substr) const {
@@ -370,6 +494,12 @@ public:
 		}
 	}
 
+	// Determines the left-most index where a match within maxdist edits of the given substr ends, and returns the start of that match. Returns -1 if no such substr is found.
+	// Among the matches with that end, the one with the fewest edits is chosen, and the longest of those on ties. A match that ends further right may start further left.
+	// Provides overload for C-str and xlstr.
+	ptrdiff_t fuzzy_indexof(const char *substr, size_t maxdist) const;
+	ptrdiff_t fuzzy_indexof(const xl_str& xlsubstr, size_t maxdist) const;
+
 	// Determine if the current xlstr includes the substr.
 	// Provides overload for C-str and xlstr.
 	bool includes(const char *substr) const {
@@ -721,6 +851,906 @@ public:
 
 };
 
+// Non-member swap, so that std algorithms exchange xlstrs without copying their contents.
+inline void swap(xl_str& xlstr1, xl_str& xlstr2) {
+	xlstr1.swap(xlstr2);
+}
+
+
+
+// THE XL_STR_MATCHER CLASS.
+class xl_str_matcher {
+
+	// The pattern length and the number of 64-row blocks it occupies.
+	size_t patlen;
+	size_t blockcount;
+	// Match bitmasks of the pattern and of the reversed pattern, indexed by [character * blockcount + block].
+	// Bit i of a block is set if the character occurs at row 64 * block + i.
+	std::vector<unsigned long long> peqs;
+	std::vector<unsigned long long> rpeqs;
+
+	// Advances one block of the current column by one text character, given the match bitmask and the horizontal delta entering the block from above.
+	// Returns the horizontal delta leaving the block at the row selected by highbit: +1, 0 or -1.
+	static int advanceblock(unsigned long long& pv, unsigned long long& mv, unsigned long long eq, int hin, unsigned long long highbit) {
+		unsigned long long xv = eq | mv;
+		if (hin < 0) eq |= 1;
+		unsigned long long xh = (((eq & pv) + pv) ^ pv) | eq;
+		unsigned long long ph = mv | ~(xh | pv);
+		unsigned long long mh = pv & xh;
+		int hout = (ph & highbit) ? 1 : ((mh & highbit) ? -1 : 0);
+		ph <<= 1;
+		mh <<= 1;
+		if (hin < 0) mh |= 1;
+		else if (hin > 0) ph |= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+		return hout;
+	}
+
+	// Resets the positive and negative vertical delta vectors pvs and mvs, one word per block, to the first column, where the vertical deltas are all +1.
+	void resetcolumn(unsigned long long *pvs, unsigned long long *mvs) const {
+		for (size_t b = 0; b < this->blockcount; b++) {
+			pvs[b] = ~0ULL;
+			mvs[b] = 0;
+		}
+	}
+
+	// Advances the whole column by one text character and returns the change of the score in the last pattern row.
+	// hin is +1 when the text is aligned from its start (global distance) and 0 when the match may start anywhere (search).
+	int advancecolumn(unsigned long long *pvs, unsigned long long *mvs, const unsigned long long *eqs, int hin) const {
+		size_t lastblock = this->blockcount - 1;
+		for (size_t b = 0; b < lastblock; b++) hin = advanceblock(pvs[b], mvs[b], eqs[b], hin, 1ULL << 63);
+		return advanceblock(pvs[lastblock], mvs[lastblock], eqs[lastblock], hin, 1ULL << ((this->patlen - 1) % 64));
+	}
+
+	// Implementations of distance and fuzzy_indexof on the given delta vectors, which must hold blockcount words each.
+	ptrdiff_t distance(const char *text, size_t maxdist, unsigned long long *pvs, unsigned long long *mvs) const {
+		size_t textlen = strlen(text);
+		size_t lendiff = textlen > this->patlen ? textlen - this->patlen : this->patlen - textlen;
+		if (lendiff > maxdist) return -1;
+		if (this->patlen == 0) return (ptrdiff_t)textlen;
+		this->resetcolumn(pvs, mvs);
+		size_t score = this->patlen;
+		for (size_t j = 0; j < textlen; j++) {
+			score += this->advancecolumn(pvs, mvs, &this->peqs[(unsigned char)text[j] * this->blockcount], 1);
+			size_t remaining = textlen - j - 1;
+			if (score > remaining && score - remaining > maxdist) return -1;
+		}
+		return (ptrdiff_t)score;
+	}
+	ptrdiff_t fuzzy_indexof(const char *text, size_t maxdist, unsigned long long *pvs, unsigned long long *mvs) const {
+		if (this->patlen <= maxdist) return 0;
+		this->resetcolumn(pvs, mvs);
+		size_t score = this->patlen;
+		size_t end = 0;
+		bool found = false;
+		for (const char *ptr = text; *ptr != 0; ptr++) {
+			score += this->advancecolumn(pvs, mvs, &this->peqs[(unsigned char)*ptr * this->blockcount], 0);
+			if (score <= maxdist) {
+				end = ptr - text + 1;
+				found = true;
+				break;
+			}
+		}
+		if (!found) return -1;
+		size_t windowlen = end < this->patlen + maxdist ? end : this->patlen + maxdist;
+		this->resetcolumn(pvs, mvs);
+		score = this->patlen;
+		size_t bestscore = score;
+		size_t bestlen = 0;
+		for (size_t len = 1; len <= windowlen; len++) {
+			score += this->advancecolumn(pvs, mvs, &this->rpeqs[(unsigned char)text[end - len] * this->blockcount], 1);
+			if (score <= bestscore) {
+				bestscore = score;
+				bestlen = len;
+			}
+		}
+		return (ptrdiff_t)(end - bestlen);
+	}
+
+public:
+
+	// Caller-owned scratch space for the delta vectors of patterns longer than 64 characters.
+	// Patterns of up to 64 characters keep them on the stack, and methods called without a workspace allocate a temporary one for longer patterns.
+	// A workspace grows to fit the largest matcher it is used with, so one workspace per thread serves any number of matchers and calls without further allocation.
+	class workspace {
+		friend class xl_str_matcher;
+		std::vector<unsigned long long> pvs;
+		std::vector<unsigned long long> mvs;
+		void fit(size_t blockcount) {
+			if (this->pvs.size() < blockcount) {
+				this->pvs.resize(blockcount);
+				this->mvs.resize(blockcount);
+			}
+		}
+	};
+
+	// Parametric constructor: Precompiles the C-style str as the pattern.
+	xl_str_matcher(const char *pattern) {
+		this->patlen = strlen(pattern);
+		this->blockcount = this->patlen == 0 ? 1 : (this->patlen + 63) / 64;
+		this->peqs.assign(256 * this->blockcount, 0);
+		this->rpeqs.assign(256 * this->blockcount, 0);
+		for (size_t i = 0; i < this->patlen; i++) {
+			size_t ri = this->patlen - 1 - i;
+			this->peqs[(unsigned char)pattern[i] * this->blockcount + i / 64] |= 1ULL << (i % 64);
+			this->rpeqs[(unsigned char)pattern[i] * this->blockcount + ri / 64] |= 1ULL << (ri % 64);
+		}
+	}
+	// Parametric constructor: Precompiles the xlstr's content as the pattern.
+	xl_str_matcher(const xl_str& xlpattern) : xl_str_matcher(xlpattern()) {}
+
+	// Returns the length of the pattern.
+	size_t size() const {
+		return this->patlen;
+	}
+
+	// Returns the Levenshtein distance between the pattern and text.
+	// Returns -1 once the distance is known to exceed maxdist: either the lengths differ by more than maxdist, or the score in the last pattern row stays above maxdist even if every remaining text character lowers it by one.
+	// The overload with a workspace never allocates memory.
+	ptrdiff_t distance(const char *text, size_t maxdist, workspace& ws) const {
+		ws.fit(this->blockcount);
+		return this->distance(text, maxdist, ws.pvs.data(), ws.mvs.data());
+	}
+	ptrdiff_t distance(const char *text, size_t maxdist) const {
+		if (this->blockcount == 1) {
+			unsigned long long pv, mv;
+			return this->distance(text, maxdist, &pv, &mv);
+		}
+		workspace ws;
+		return this->distance(text, maxdist, ws);
+	}
+	size_t distance(const char *text) const {
+		return (size_t)this->distance(text, (size_t)-1);
+	}
+	ptrdiff_t distance(const xl_str& xltext, size_t maxdist) const {
+		return this->distance(xltext(), maxdist);
+	}
+	size_t distance(const xl_str& xltext) const {
+		return this->distance(xltext());
+	}
+
+	// Determines the left-most index of text where a match within maxdist edits of the pattern ends, and returns the start of that match. Returns -1 if no such substr is found.
+	// The start is found by a backward pass of the reversed pattern over at most patlen + maxdist characters before the end, choosing the start with the fewest edits and the longest match on ties.
+	// A match that ends further right may still start further left, e.g. "xabcd" is within one edit of "abcd", but the match "abc" ends first and gives index 1.
+	ptrdiff_t fuzzy_indexof(const char *text, size_t maxdist, workspace& ws) const {
+		ws.fit(this->blockcount);
+		return this->fuzzy_indexof(text, maxdist, ws.pvs.data(), ws.mvs.data());
+	}
+	ptrdiff_t fuzzy_indexof(const char *text, size_t maxdist) const {
+		if (this->blockcount == 1) {
+			unsigned long long pv, mv;
+			return this->fuzzy_indexof(text, maxdist, &pv, &mv);
+		}
+		workspace ws;
+		return this->fuzzy_indexof(text, maxdist, ws);
+	}
+	ptrdiff_t fuzzy_indexof(const xl_str& xltext, size_t maxdist) const {
+		return this->fuzzy_indexof(xltext(), maxdist);
+	}
+
+	// Writes the distance between the pattern and each xlstr in the collection to results, which must hold xlstrs.size() elements, with -1 for those beyond maxdist.
+	// The delta vectors are shared by all candidates, so at most one workspace is allocated per call, and none with a caller-owned workspace. A further overload returns the results as a new vector instead.
+	void distances(const xl_str_collection& xlstrs, size_t maxdist, ptrdiff_t *results, workspace& ws) const;
+	void distances(const xl_str_collection& xlstrs, size_t maxdist, ptrdiff_t *results) const;
+	std::vector<ptrdiff_t> distances(const xl_str_collection& xlstrs, size_t maxdist = (size_t)-1) const;
+
+};
+
+
+
+// THE XL_FILE_MAP CLASS.
+class xl_file_map {
+
+	// The readonly contents of the file, either mapped with mmap or read into a malloc'd buffer.
+	void *ptr;
+	size_t len;
+	bool mapped;
+
+public:
+
+	// Default constructor: Instantiates an empty map.
+	xl_file_map() : ptr(nullptr), len(0), mapped(false) {}
+	// A map owns its memory, so it can be neither copied nor reassigned.
+	xl_file_map(const xl_file_map&) = delete;
+	xl_file_map& operator=(const xl_file_map&) = delete;
+
+	// Destructor: Releases the contents upon destruction.
+	~xl_file_map() {
+		this->close();
+	}
+
+	// Maps the file at path readonly, releasing any previous contents. Returns false if the file cannot be opened or is empty.
+	bool open(const char *path) {
+		this->close();
+#if defined(__unix__) || defined(__APPLE__)
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+			::close(fd);
+			return false;
+		}
+		void *addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (addr == MAP_FAILED) return false;
+		this->ptr = addr;
+		this->len = (size_t)st.st_size;
+		this->mapped = true;
+		return true;
+#else
+		FILE *file = fopen(path, "rb");
+		if (file == nullptr) return false;
+		long filelen = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+		if (filelen <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+			fclose(file);
+			return false;
+		}
+		void *buf = malloc((size_t)filelen);
+		if (buf == nullptr || fread(buf, 1, (size_t)filelen, file) != (size_t)filelen) {
+			free(buf);
+			fclose(file);
+			return false;
+		}
+		fclose(file);
+		this->ptr = buf;
+		this->len = (size_t)filelen;
+		this->mapped = false;
+		return true;
+#endif
+	}
+
+	// Releases the contents. Pointers previously obtained from data become invalid.
+	void close() {
+		if (this->ptr == nullptr) return;
+#if defined(__unix__) || defined(__APPLE__)
+		if (this->mapped) munmap(this->ptr, this->len);
+		else free(this->ptr);
+#else
+		free(this->ptr);
+#endif
+		this->ptr = nullptr;
+		this->len = 0;
+		this->mapped = false;
+	}
+
+	// Returns a const pointer to the contents, or nullptr if nothing is mapped.
+	const unsigned char *data() const {
+		return (const unsigned char *)this->ptr;
+	}
+
+	// Returns the size of the contents in bytes.
+	size_t size() const {
+		return this->len;
+	}
+
+	// Computes the 64-bit FNV-1a hash of len bytes, continuing from hash so that the input can be hashed in pieces.
+	static uint64_t fnv1a(const void *bytes, size_t len, uint64_t hash = 14695981039346656037ULL) {
+		const unsigned char *ptr = (const unsigned char *)bytes;
+		for (size_t i = 0; i < len; i++) hash = (hash ^ ptr[i]) * 1099511628211ULL;
+		return hash;
+	}
+
+};
+
+
+
+// THE XL_STR_MAPPED_COLLECTION CLASS.
+class xl_str_mapped_collection {
+
+	// The header of a file written by xl_str_collection::save.
+	struct header {
+		char magic[8];
+		uint32_t version;
+		uint32_t flags;
+		uint64_t count;
+		uint64_t blobsize;
+		uint64_t checksum;
+	};
+
+	xl_file_map file;
+	size_t count;
+	const uint64_t *offsets;
+	const char *blob;
+
+	friend class xl_str_collection;
+	static constexpr uint32_t formatversion = 1;
+	static constexpr uint32_t checksumflag = 1;
+
+public:
+
+	// Default constructor: Instantiates an empty collection.
+	xl_str_mapped_collection() : count(0), offsets(nullptr), blob(nullptr) {}
+	// Parametric constructor: Opens the file at path. Use size to tell an empty collection from a file that failed to open, or call open directly to get the result.
+	xl_str_mapped_collection(const char *path, bool verify = false) : xl_str_mapped_collection() {
+		this->open(path, verify);
+	}
+
+	// Opens a file written by xl_str_collection::save, releasing any previous file. Returns false and leaves the collection empty if the file is invalid.
+	// The header and the bounds of the offsets array and blob are always checked, which costs the same regardless of the element count.
+	// Without verify, the offsets in between are only checked as each element is accessed, so a corrupted offset makes that element read as missing rather than out of bounds.
+	// If verify is true, the checksum (when present) and every offset are checked as well, which reads the whole file.
+	bool open(const char *path, bool verify = false) {
+		this->close();
+		if (!this->file.open(path)) return false;
+		const unsigned char *data = this->file.data();
+		size_t filelen = this->file.size();
+		header hdr;
+		if (filelen < sizeof(header)) return this->fail();
+		memcpy(&hdr, data, sizeof(header));
+		if (memcmp(hdr.magic, "XLSTRCOL", 8) != 0 || hdr.version != formatversion) return this->fail();
+		size_t maxcount = (filelen - sizeof(header)) / sizeof(uint64_t);
+		if (hdr.count >= maxcount) return this->fail();
+		size_t offsetslen = sizeof(uint64_t) * (size_t)(hdr.count + 1);
+		if (hdr.blobsize != filelen - sizeof(header) - offsetslen) return this->fail();
+		const uint64_t *offsets = (const uint64_t *)(data + sizeof(header));
+		const char *blob = (const char *)(data + sizeof(header) + offsetslen);
+		if (offsets[0] != 0 || offsets[hdr.count] != hdr.blobsize) return this->fail();
+		if (hdr.blobsize != 0 && blob[hdr.blobsize - 1] != 0) return this->fail();
+		if (verify) {
+			if ((hdr.flags & checksumflag) != 0) {
+				uint64_t checksum = xl_file_map::fnv1a(offsets, offsetslen);
+				checksum = xl_file_map::fnv1a(blob, (size_t)hdr.blobsize, checksum);
+				if (checksum != hdr.checksum) return this->fail();
+			}
+			for (size_t i = 0; i < hdr.count; i++) {
+				if (offsets[i + 1] <= offsets[i] || blob[offsets[i + 1] - 1] != 0) return this->fail();
+			}
+		}
+		this->count = (size_t)hdr.count;
+		this->offsets = offsets;
+		this->blob = blob;
+		return true;
+	}
+
+	// Releases the file. Pointers previously obtained from the collection become invalid.
+	void close() {
+		this->file.close();
+		this->count = 0;
+		this->offsets = nullptr;
+		this->blob = nullptr;
+	}
+
+	// Returns the number of elements.
+	size_t size() const {
+		return this->count;
+	}
+
+	// Returns a const pointer to element i as a C-style str inside the file, which stays valid until the collection is closed.
+	// If the index overflows or the offsets of element i are corrupted, returns nullptr.
+	const char *operator[](size_t i) const {
+		if (!this->valid(i)) return nullptr;
+		else return this->blob + this->offsets[i];
+	}
+
+	// Returns the length of element i excluding the ending '\0', read from the offsets without scanning the str.
+	// If the index overflows or the offsets of element i are corrupted, returns 0.
+	size_t length(size_t i) const {
+		if (!this->valid(i)) return 0;
+		else return (size_t)(this->offsets[i + 1] - this->offsets[i] - 1);
+	}
+
+	// Returns a new xl_str_collection with a copy of every element, for callers that need owning xlstrs.
+	// Elements with corrupted offsets are copied as empty xlstrs.
+	xl_str_collection collect() const {
+		xl_str_collection xlstrs;
+		xlstrs.reserve(this->count);
+		for (size_t i = 0; i < this->count; i++) {
+			const char *str = (*this)[i];
+			xlstrs.push_back(xl_str(str == nullptr ? "" : str));
+		}
+		return xlstrs;
+	}
+
+private:
+
+	// Determines if element i exists and its offsets lie in order within the blob, whose size open has checked against offsets[count].
+	// Together with the '\0' that open has checked at the end of the blob, this keeps every element inside the file.
+	bool valid(size_t i) const {
+		return i < this->count && this->offsets[i] < this->offsets[i + 1] && this->offsets[i + 1] <= this->offsets[this->count];
+	}
+
+	// Releases a file that failed validation and reports the failure.
+	bool fail() {
+		this->close();
+		return false;
+	}
+
+};
+
+
+
+// THE XL_STR_INDEX CLASS.
+class xl_str_index {
+
+	// The header of a file written by save.
+	struct header {
+		char magic[8];
+		uint32_t version;
+		uint32_t flags;
+		uint64_t textlen;
+		uint64_t texthash;
+		uint64_t checksum;
+	};
+
+	// Version 1 files had a 32-byte header without the array checksum and no range tables, and are rejected.
+	static constexpr uint32_t formatversion = 2;
+	// The number of suffix array entries per block of the range tables.
+	static constexpr size_t blocksize = 32;
+
+	// The indexed C-style str, which is not owned by the index.
+	const char *text;
+	size_t textlen;
+	// The suffix array and the LCP array, where lcp[i] is the length of the longest common prefix of the suffixes at sa[i - 1] and sa[i], and lcp[0] = 0.
+	// They point either into the vectors below after build, or into the mapped file after load.
+	const int *sa;
+	const int *lcp;
+	// Sparse tables of the minimum and maximum of sa, where level k at block i covers the 2^k blocks of blocksize entries starting at block i.
+	// Entries whose span would run past the last block repeat the level below and are never read.
+	size_t blockcount;
+	size_t levelcount;
+	const int *mins;
+	const int *maxs;
+	std::vector<int> savec;
+	std::vector<int> lcpvec;
+	std::vector<int> minvec;
+	std::vector<int> maxvec;
+	xl_file_map file;
+
+	// Returns floor(log2(x)) for x > 0.
+	static size_t floorlog2(size_t x) {
+		size_t k = 0;
+		while (x >>= 1) k++;
+		return k;
+	}
+
+	// Returns the number of blocks and sparse table levels for a text of textlen characters.
+	static void tablesize(size_t textlen, size_t& blockcount, size_t& levelcount) {
+		blockcount = (textlen + blocksize - 1) / blocksize;
+		levelcount = blockcount == 0 ? 0 : floorlog2(blockcount) + 1;
+	}
+
+	// Builds the sparse tables of the minimum and maximum of sa.
+	void buildtables() {
+		tablesize(this->textlen, this->blockcount, this->levelcount);
+		size_t bc = this->blockcount;
+		this->minvec.assign(bc * this->levelcount, 0);
+		this->maxvec.assign(bc * this->levelcount, 0);
+		for (size_t b = 0; b < bc; b++) {
+			size_t end = (b + 1) * blocksize < this->textlen ? (b + 1) * blocksize : this->textlen;
+			int lo = this->savec[b * blocksize], hi = lo;
+			for (size_t i = b * blocksize + 1; i < end; i++) {
+				if (this->savec[i] < lo) lo = this->savec[i];
+				if (this->savec[i] > hi) hi = this->savec[i];
+			}
+			this->minvec[b] = lo;
+			this->maxvec[b] = hi;
+		}
+		for (size_t k = 1; k < this->levelcount; k++) {
+			const int *prevmins = &this->minvec[(k - 1) * bc];
+			const int *prevmaxs = &this->maxvec[(k - 1) * bc];
+			int *curmins = &this->minvec[k * bc];
+			int *curmaxs = &this->maxvec[k * bc];
+			size_t half = (size_t)1 << (k - 1);
+			for (size_t b = 0; b < bc; b++) {
+				if (b + half < bc) {
+					curmins[b] = prevmins[b] < prevmins[b + half] ? prevmins[b] : prevmins[b + half];
+					curmaxs[b] = prevmaxs[b] > prevmaxs[b + half] ? prevmaxs[b] : prevmaxs[b + half];
+				} else {
+					curmins[b] = prevmins[b];
+					curmaxs[b] = prevmaxs[b];
+				}
+			}
+		}
+	}
+
+	// Returns the minimum (upper == false) or maximum (upper == true) of sa over the non-empty range [first, last).
+	// Whole blocks are covered by two overlapping sparse table entries, and at most 2 * blocksize entries outside them are scanned.
+	int rangeextreme(size_t first, size_t last, bool upper) const {
+		int best = this->sa[first];
+		size_t firstblock = (first + blocksize - 1) / blocksize;
+		size_t lastblock = last / blocksize;
+		size_t scanend = last;
+		if (firstblock < lastblock) {
+			const int *table = upper ? this->maxs : this->mins;
+			size_t k = floorlog2(lastblock - firstblock);
+			int a = table[k * this->blockcount + firstblock];
+			int b = table[k * this->blockcount + lastblock - ((size_t)1 << k)];
+			int tablebest = upper ? (a > b ? a : b) : (a < b ? a : b);
+			if (upper ? tablebest > best : tablebest < best) best = tablebest;
+			for (size_t i = lastblock * blocksize; i < last; i++) if (upper ? this->sa[i] > best : this->sa[i] < best) best = this->sa[i];
+			scanend = firstblock * blocksize;
+		}
+		for (size_t i = first; i < scanend; i++) if (upper ? this->sa[i] > best : this->sa[i] < best) best = this->sa[i];
+		return best;
+	}
+
+	// Returns the FNV-1a hash of the suffix array, the LCP array and the range tables, in file order.
+	uint64_t checksum() const {
+		uint64_t hash = xl_file_map::fnv1a(this->sa, sizeof(int) * this->textlen);
+		hash = xl_file_map::fnv1a(this->lcp, sizeof(int) * this->textlen, hash);
+		hash = xl_file_map::fnv1a(this->mins, sizeof(int) * this->blockcount * this->levelcount, hash);
+		return xl_file_map::fnv1a(this->maxs, sizeof(int) * this->blockcount * this->levelcount, hash);
+	}
+
+	// Sorts the suffixes of s, whose characters lie in [0, upper], with SA-IS.
+	// The LMS substrs are sorted by one induced sort, named, and sorted recursively when names repeat, and the final order is induced from the sorted LMS suffixes.
+	template <typename T>
+	static std::vector<int> sais(const T *s, int n, int upper) {
+		if (n == 0) return std::vector<int>();
+		if (n == 1) return std::vector<int>(1, 0);
+		if (n == 2) {
+			std::vector<int> sa(2);
+			sa[0] = (s[0] < s[1]) ? 0 : 1;
+			sa[1] = 1 - sa[0];
+			return sa;
+		}
+		std::vector<int> sa(n);
+		// stype[i] is true if the suffix at i is smaller than the suffix at i + 1.
+		std::vector<bool> stype(n, false);
+		for (int i = n - 2; i >= 0; i--) stype[i] = (s[i] == s[i + 1]) ? stype[i + 1] : (s[i] < s[i + 1]);
+		// Start of the S-type and L-type part of each character's bucket.
+		std::vector<int> sstarts(upper + 1, 0), lstarts(upper + 1, 0);
+		for (int i = 0; i < n; i++) {
+			if (!stype[i]) sstarts[s[i]]++;
+			else lstarts[s[i] + 1]++;
+		}
+		for (int c = 0; c <= upper; c++) {
+			sstarts[c] += lstarts[c];
+			if (c < upper) lstarts[c + 1] += sstarts[c];
+		}
+		std::vector<int> buckets(upper + 1);
+		// Places the LMS suffixes in the given order at the starts of their S-type parts, then induces the L-type suffixes left to right and the S-type suffixes right to left.
+		auto induce = [&](const std::vector<int>& lms) {
+			for (int i = 0; i < n; i++) sa[i] = -1;
+			for (int c = 0; c <= upper; c++) buckets[c] = sstarts[c];
+			for (int d : lms) sa[buckets[s[d]]++] = d;
+			for (int c = 0; c <= upper; c++) buckets[c] = lstarts[c];
+			sa[buckets[s[n - 1]]++] = n - 1;
+			for (int i = 0; i < n; i++) {
+				int v = sa[i];
+				if (v >= 1 && !stype[v - 1]) sa[buckets[s[v - 1]]++] = v - 1;
+			}
+			for (int c = 0; c <= upper; c++) buckets[c] = lstarts[c];
+			for (int i = n - 1; i >= 0; i--) {
+				int v = sa[i];
+				if (v >= 1 && stype[v - 1]) sa[--buckets[s[v - 1] + 1]] = v - 1;
+			}
+		};
+		std::vector<int> lmsids(n + 1, -1);
+		std::vector<int> lms;
+		for (int i = 1; i < n; i++) {
+			if (!stype[i - 1] && stype[i]) {
+				lmsids[i] = (int)lms.size();
+				lms.push_back(i);
+			}
+		}
+		int m = (int)lms.size();
+		induce(lms);
+		if (m == 0) return sa;
+		std::vector<int> sortedlms;
+		sortedlms.reserve(m);
+		for (int v : sa) if (lmsids[v] != -1) sortedlms.push_back(v);
+		// Names the LMS substrs in sorted order, giving equal substrs the same name.
+		std::vector<int> names(m);
+		int nameupper = 0;
+		names[lmsids[sortedlms[0]]] = 0;
+		for (int i = 1; i < m; i++) {
+			int l = sortedlms[i - 1], r = sortedlms[i];
+			int endl = (lmsids[l] + 1 < m) ? lms[lmsids[l] + 1] : n;
+			int endr = (lmsids[r] + 1 < m) ? lms[lmsids[r] + 1] : n;
+			bool same = true;
+			if (endl - l != endr - r) {
+				same = false;
+			} else {
+				while (l < endl && s[l] == s[r]) {
+					l++;
+					r++;
+				}
+				if (l == n || s[l] != s[r]) same = false;
+			}
+			if (!same) nameupper++;
+			names[lmsids[sortedlms[i]]] = nameupper;
+		}
+		std::vector<int> namesa = sais(names.data(), m, nameupper);
+		for (int i = 0; i < m; i++) sortedlms[i] = lms[namesa[i]];
+		induce(sortedlms);
+		return sa;
+	}
+
+	// Computes lcp[rank[i]] for the text positions in [begin, end) with Kasai's algorithm.
+	// Each chunk starts from an unknown common prefix, so chunks can run in parallel at the cost of rescanning at most one prefix per chunk.
+	static void kasai(const char *text, size_t textlen, const int *sa, const int *rank, int *lcp, size_t begin, size_t end) {
+		size_t h = 0;
+		for (size_t i = begin; i < end; i++) {
+			if (rank[i] == 0) {
+				h = 0;
+				continue;
+			}
+			size_t j = (size_t)sa[rank[i] - 1];
+			while (i + h < textlen && j + h < textlen && text[i + h] == text[j + h]) h++;
+			lcp[rank[i]] = (int)h;
+			if (h > 0) h--;
+		}
+	}
+
+	// Runs body(begin, end) over [0, count) split into one chunk per thread, on the calling thread alone if threads <= 1.
+	template <typename F>
+	static void parallelfor(size_t count, unsigned threads, F body) {
+		if (threads <= 1 || count < 2 * (size_t)threads) {
+			body((size_t)0, count);
+			return;
+		}
+		std::vector<std::thread> workers;
+		size_t chunk = (count + threads - 1) / threads;
+		for (size_t begin = 0; begin < count; begin += chunk) {
+			size_t end = begin + chunk < count ? begin + chunk : count;
+			workers.push_back(std::thread(body, begin, end));
+		}
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	// Returns the length of the common prefix of pattern and the suffix at pos, comparing from start onwards, which is known to match.
+	size_t matchlen(const char *pattern, size_t patlen, size_t pos, size_t start) const {
+		const char *suffix = this->text + pos;
+		size_t j = start;
+		while (j < patlen && suffix[j] == pattern[j]) j++;
+		return j;
+	}
+
+	// Returns the first suffix array position whose suffix, truncated to the pattern length, is greater than or equal to the pattern (upper == false) or greater than the pattern (upper == true).
+	// lcplo and lcphi hold the matched lengths of the suffixes just outside the search range; every suffix inside shares the smaller of the two with the pattern, which the comparison skips.
+	size_t search(const char *pattern, size_t patlen, bool upper) const {
+		size_t lo = 0, hi = this->textlen;
+		size_t lcplo = 0, lcphi = 0;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			size_t pos = (size_t)this->sa[mid];
+			size_t j = this->matchlen(pattern, patlen, pos, lcplo < lcphi ? lcplo : lcphi);
+			bool before = (j == patlen) ? upper : ((unsigned char)this->text[pos + j] < (unsigned char)pattern[j]);
+			if (before) {
+				lo = mid + 1;
+				lcplo = j;
+			} else {
+				hi = mid;
+				lcphi = j;
+			}
+		}
+		return lo;
+	}
+
+	// Returns the range [first, last) of suffix array positions whose suffixes start with substr.
+	void range(const char *substr, size_t& first, size_t& last) const {
+		size_t patlen = strlen(substr);
+		first = this->search(substr, patlen, false);
+		last = this->search(substr, patlen, true);
+	}
+
+public:
+
+	// Default constructor: Instantiates an empty index, to be built or loaded later.
+	xl_str_index() : text(""), textlen(0), sa(nullptr), lcp(nullptr), blockcount(0), levelcount(0), mins(nullptr), maxs(nullptr) {}
+	// Parametric constructor: Builds the index over the xlstr. Use size to tell an index of an empty xlstr from a failed build, or call build directly to get the result.
+	explicit xl_str_index(const xl_str& xltext, unsigned threads = 1) : xl_str_index() {
+		this->build(xltext, threads);
+	}
+	// An index may own a mapped file, so it can be neither copied nor reassigned.
+	xl_str_index(const xl_str_index&) = delete;
+	xl_str_index& operator=(const xl_str_index&) = delete;
+
+	// Builds the suffix array, the LCP array and the range tables of the xlstr, releasing any previous index.
+	// threads sets how many threads compute the rank and LCP arrays; 0 uses std::thread::hardware_concurrency.
+	// Returns false and leaves the index empty if the xlstr is longer than INT_MAX - 1 characters.
+	bool build(const xl_str& xltext, unsigned threads = 1) {
+		this->clear();
+		size_t textlen = xltext.size();
+		if (textlen >= (size_t)INT_MAX) return false;
+		if (threads == 0) threads = std::thread::hardware_concurrency();
+		const char *text = xltext();
+		int n = (int)textlen;
+		this->savec = sais((const unsigned char *)text, n, 255);
+		std::vector<int> rank(textlen);
+		this->lcpvec.assign(textlen, 0);
+		const int *sa = this->savec.data();
+		int *rankptr = rank.data();
+		int *lcp = this->lcpvec.data();
+		parallelfor(textlen, threads, [sa, rankptr](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) rankptr[sa[i]] = (int)i;
+		});
+		parallelfor(textlen, threads, [text, textlen, sa, rankptr, lcp](size_t begin, size_t end) {
+			kasai(text, textlen, sa, rankptr, lcp, begin, end);
+		});
+		this->text = text;
+		this->textlen = textlen;
+		this->sa = this->savec.data();
+		this->lcp = this->lcpvec.data();
+		this->buildtables();
+		this->mins = this->minvec.data();
+		this->maxs = this->maxvec.data();
+		return true;
+	}
+
+	// Releases the index, leaving it empty.
+	void clear() {
+		this->text = "";
+		this->textlen = 0;
+		this->sa = nullptr;
+		this->lcp = nullptr;
+		this->blockcount = 0;
+		this->levelcount = 0;
+		this->mins = nullptr;
+		this->maxs = nullptr;
+		this->savec = std::vector<int>();
+		this->lcpvec = std::vector<int>();
+		this->minvec = std::vector<int>();
+		this->maxvec = std::vector<int>();
+		this->file.close();
+	}
+
+	// Writes the index to path: a 40-byte header (magic "XLSTRIDX", version, flags, text length, FNV-1a hash of the text, FNV-1a checksum of the arrays), then the suffix array, the LCP array and the minimum and maximum range tables as 32-bit ints in native byte order.
+	// The text itself is not written, and must be saved separately. An empty or unbuilt index writes the header alone. Returns false if the file cannot be written.
+	bool save(const char *path) const {
+		header hdr;
+		memcpy(hdr.magic, "XLSTRIDX", 8);
+		hdr.version = formatversion;
+		hdr.flags = 0;
+		hdr.textlen = this->textlen;
+		hdr.texthash = xl_file_map::fnv1a(this->text, this->textlen);
+		hdr.checksum = this->checksum();
+		size_t tablelen = this->blockcount * this->levelcount;
+		FILE *file = fopen(path, "wb");
+		if (file == nullptr) return false;
+		bool ok = fwrite(&hdr, sizeof(hdr), 1, file) == 1;
+		if (this->textlen != 0) {
+			ok = ok && fwrite(this->sa, sizeof(int), this->textlen, file) == this->textlen;
+			ok = ok && fwrite(this->lcp, sizeof(int), this->textlen, file) == this->textlen;
+			ok = ok && fwrite(this->mins, sizeof(int), tablelen, file) == tablelen;
+			ok = ok && fwrite(this->maxs, sizeof(int), tablelen, file) == tablelen;
+		}
+		ok = (fclose(file) == 0) && ok;
+		return ok;
+	}
+
+	// Loads an index written by save for the same xlstr, releasing any previous index. The arrays are mapped, not copied.
+	// The text length is always checked against the file. If verify is true, the hash of the text and the checksum of the arrays are checked as well, and every suffix array entry is checked to lie within the xlstr.
+	// Verification reads the whole file and xlstr, but is still far cheaper than a build. Without it, a corrupted file can make queries read outside the xlstr.
+	// Returns false and leaves the index empty if the file is invalid or was built for another xlstr.
+	bool load(const char *path, const xl_str& xltext, bool verify = false) {
+		this->clear();
+		if (!this->file.open(path)) return false;
+		const unsigned char *data = this->file.data();
+		size_t filelen = this->file.size();
+		size_t textlen = xltext.size();
+		header hdr;
+		if (filelen < sizeof(header)) return this->fail();
+		memcpy(&hdr, data, sizeof(header));
+		if (memcmp(hdr.magic, "XLSTRIDX", 8) != 0 || hdr.version != formatversion) return this->fail();
+		size_t blockcount, levelcount;
+		tablesize(textlen, blockcount, levelcount);
+		if (hdr.textlen != textlen || filelen != sizeof(header) + sizeof(int) * (2 * textlen + 2 * blockcount * levelcount)) return this->fail();
+		if (verify && xl_file_map::fnv1a(xltext(), textlen) != hdr.texthash) return this->fail();
+		this->text = xltext();
+		this->textlen = textlen;
+		this->sa = (const int *)(data + sizeof(header));
+		this->lcp = this->sa + textlen;
+		this->blockcount = blockcount;
+		this->levelcount = levelcount;
+		this->mins = this->lcp + textlen;
+		this->maxs = this->mins + blockcount * levelcount;
+		if (verify) {
+			if (this->checksum() != hdr.checksum) return this->fail();
+			for (size_t i = 0; i < textlen; i++) if (this->sa[i] < 0 || (size_t)this->sa[i] >= textlen) return this->fail();
+		}
+		return true;
+	}
+
+	// Returns the length of the indexed xlstr.
+	size_t size() const {
+		return this->textlen;
+	}
+
+	// Returns the start of the i-th smallest suffix of the indexed xlstr. If the index overflows, returns -1.
+	ptrdiff_t suffix(size_t i) const {
+		return (i >= this->textlen) ? -1 : this->sa[i];
+	}
+
+	// Returns the length of the longest common prefix of the (i - 1)-th and i-th smallest suffixes, or 0 for i = 0 or an overflowing index.
+	size_t commonprefix(size_t i) const {
+		return (i >= this->textlen) ? 0 : (size_t)this->lcp[i];
+	}
+
+	// Determines if the indexed xlstr includes the substr.
+	// Provides overload for C-str and xlstr.
+	bool includes(const char *substr) const {
+		size_t patlen = strlen(substr);
+		if (patlen == 0) return true;
+		size_t first = this->search(substr, patlen, false);
+		return first < this->textlen && this->matchlen(substr, patlen, (size_t)this->sa[first], 0) == patlen;
+	}
+	bool includes(const xl_str& xlsubstr) const {
+		return this->includes(xlsubstr());
+	}
+
+	// Returns the number of possibly overlapping occurrences of substr. An empty substr occurs at every position including the end.
+	// Provides overload for C-str and xlstr.
+	size_t count(const char *substr) const {
+		if (*substr == 0) return this->textlen + 1;
+		size_t first, last;
+		this->range(substr, first, last);
+		return last - first;
+	}
+	size_t count(const xl_str& xlsubstr) const {
+		return this->count(xlsubstr());
+	}
+
+	// Determines the left-most index where substr is found. Returns -1 if no substr is found.
+	// Provides overload for C-str and xlstr.
+	ptrdiff_t indexof(const char *substr) const {
+		if (*substr == 0) return 0;
+		size_t first, last;
+		this->range(substr, first, last);
+		return (first < last) ? this->rangeextreme(first, last, false) : -1;
+	}
+	ptrdiff_t indexof(const xl_str& xlsubstr) const {
+		return this->indexof(xlsubstr());
+	}
+
+	// Determines the right-most index where substr is found. Returns -1 if no substr is found.
+	// Provides overload for C-str and xlstr.
+	ptrdiff_t lastindexof(const char *substr) const {
+		if (*substr == 0) return (ptrdiff_t)this->textlen;
+		size_t first, last;
+		this->range(substr, first, last);
+		return (first < last) ? this->rangeextreme(first, last, true) : -1;
+	}
+	ptrdiff_t lastindexof(const xl_str& xlsubstr) const {
+		return this->lastindexof(xlsubstr());
+	}
+
+	// Returns the indices of all possibly overlapping occurrences of substr in ascending order.
+	// Provides overload for C-str and xlstr.
+	std::vector<size_t> findall(const char *substr) const {
+		std::vector<size_t> indices;
+		if (*substr == 0) {
+			for (size_t i = 0; i <= this->textlen; i++) indices.push_back(i);
+			return indices;
+		}
+		size_t first, last;
+		this->range(substr, first, last);
+		indices.reserve(last - first);
+		for (size_t i = first; i < last; i++) indices.push_back((size_t)this->sa[i]);
+		std::sort(indices.begin(), indices.end());
+		return indices;
+	}
+	std::vector<size_t> findall(const xl_str& xlsubstr) const {
+		return this->findall(xlsubstr());
+	}
+
+	// Returns a new xlstr with the longest substr that occurs at least twice, read off the maximum of the LCP array. Returns an empty xlstr if there is none.
+	xl_str longestrepeat() const {
+		size_t best = 0;
+		for (size_t i = 1; i < this->textlen; i++) if ((size_t)this->lcp[i] > (size_t)this->lcp[best]) best = i;
+		if (this->textlen == 0 || this->lcp[best] == 0) return xl_str("");
+		size_t cpycount = (size_t)this->lcp[best];
+		size_t memcount = cpycount + 1;
+		char *newstr = (char *)malloc(sizeof(char) * memcount);
+		memcpy(newstr, this->text + this->sa[best], sizeof(char) * cpycount);
+		newstr[memcount - 1] = 0;
+		xl_str newxlstr(newstr);
+		free(newstr);
+		return newxlstr;
+	}
+
+private:
+
+	// Releases a file that failed validation and reports the failure.
+	bool fail() {
+		this->clear();
+		return false;
+	}
+
+};
+
 
 
 // Joins all xlstrs in the xl_str_collection instance with the token and return this as a new xlstr.
@@ -747,4 +1777,195 @@ xl_str xl_str_collection::zip(const char *token) const {
 		free(newstr);
 		return newxlstr;
 	}
-}
\ No newline at end of file
+}
+
+
+
+// An entry of the pointer array sorted by sort and argsort: the C-str content, the index of its xlstr in the collection, and a cached key.
+// The key packs the 8 characters at the current depth in big-endian order, padded with '\0' past the end of the str, so that comparing keys compares those characters lexicographically.
+struct xl_str_collection::sortentry {
+	const unsigned char *str;
+	size_t idx;
+	unsigned long long key;
+};
+
+// Caches the keys of entries at depth, so partitioning reads the entry array sequentially instead of dereferencing every str.
+inline void xl_str_collection::cachekeys(sortentry *entries, size_t count, size_t depth) {
+	for (size_t i = 0; i < count; i++) {
+		const unsigned char *ptr = entries[i].str + depth;
+		unsigned long long key = 0;
+		int shift = 56;
+		while (shift >= 0 && *ptr != 0) {
+			key |= (unsigned long long)*ptr++ << shift;
+			shift -= 8;
+		}
+		entries[i].key = key;
+	}
+}
+
+// Multikey quicksort (Bentley and Sedgewick) of entries whose first depth characters are known to be equal.
+inline void xl_str_collection::sortentries(sortentry *entries, size_t count, size_t depth) {
+	cachekeys(entries, count, depth);
+	sortcachedentries(entries, count, depth);
+}
+
+// Sorts entries whose keys are cached at depth.
+// Entries are partitioned 3-way on the cached key; only the equal partition advances to depth + 8, so a shared prefix is never scanned twice.
+// The less and greater partitions are handled by recursion at the same depth, and the equal partition by the loop, so long shared prefixes do not deepen the stack.
+// Small partitions are finished by insertion sort.
+inline void xl_str_collection::sortcachedentries(sortentry *entries, size_t count, size_t depth) {
+	while (count > 16) {
+		unsigned long long a = entries[0].key;
+		unsigned long long b = entries[count / 2].key;
+		unsigned long long c = entries[count - 1].key;
+		unsigned long long pivot = (a < b) ? ((b < c) ? b : ((a < c) ? c : a)) : ((a < c) ? a : ((b < c) ? c : b));
+		// Invariant: [0, lt) < pivot, [lt, i) == pivot, [gt, count) > pivot.
+		size_t lt = 0, i = 0, gt = count;
+		while (i < gt) {
+			unsigned long long key = entries[i].key;
+			if (key < pivot) {
+				sortentry tmpentry = entries[lt];
+				entries[lt++] = entries[i];
+				entries[i++] = tmpentry;
+			} else if (key > pivot) {
+				sortentry tmpentry = entries[--gt];
+				entries[gt] = entries[i];
+				entries[i] = tmpentry;
+			} else {
+				i++;
+			}
+		}
+		sortcachedentries(entries, lt, depth);
+		sortcachedentries(entries + gt, count - gt, depth);
+		// A key with a '\0' in its last character means the strs have ended within it, so the equal entries are identical.
+		if ((pivot & 0xff) == 0) return;
+		entries += lt;
+		count = gt - lt;
+		depth += 8;
+		cachekeys(entries, count, depth);
+	}
+	for (size_t i = 1; i < count; i++) {
+		sortentry tmpentry = entries[i];
+		size_t j = i;
+		while (j > 0) {
+			const sortentry& preventry = entries[j - 1];
+			if (preventry.key < tmpentry.key) break;
+			if (preventry.key == tmpentry.key) {
+				if ((tmpentry.key & 0xff) == 0) break;
+				if (strcmp((const char *)preventry.str + depth + 8, (const char *)tmpentry.str + depth + 8) <= 0) break;
+			}
+			entries[j] = entries[j - 1];
+			j--;
+		}
+		entries[j] = tmpentry;
+	}
+}
+
+// Returns the indices of the xlstrs in ascending order, consistent with xl_str::compare.
+// The collection itself is not modified. The order of equal xlstrs is unspecified.
+inline std::vector<size_t> xl_str_collection::argsort() const {
+	std::vector<sortentry> entries(this->size());
+	for (size_t i = 0; i < this->size(); i++) entries[i] = { (const unsigned char *)(*this)[i](), i, 0 };
+	sortentries(entries.data(), entries.size(), 0);
+	std::vector<size_t> indices(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) indices[i] = entries[i].idx;
+	return indices;
+}
+
+// Sorts the xlstrs in ascending order, consistent with xl_str::compare.
+// The permutation found by argsort is applied cycle by cycle with xl_str::swap, so no str content is copied or reallocated.
+// The sort is not stable, which makes no difference since equal xlstrs are indistinguishable.
+inline void xl_str_collection::sort() {
+	std::vector<size_t> indices = this->argsort();
+	for (size_t i = 0; i < indices.size(); i++) {
+		size_t j = i;
+		while (indices[j] != i) {
+			size_t next = indices[j];
+			(*this)[j].swap((*this)[next]);
+			indices[j] = j;
+			j = next;
+		}
+		indices[j] = j;
+	}
+}
+
+
+
+// Scores every xlstr of the collection against the precompiled pattern with the same delta vectors.
+inline void xl_str_matcher::distances(const xl_str_collection& xlstrs, size_t maxdist, ptrdiff_t *results, workspace& ws) const {
+	ws.fit(this->blockcount);
+	for (size_t i = 0; i < xlstrs.size(); i++) results[i] = this->distance(xlstrs[i](), maxdist, ws.pvs.data(), ws.mvs.data());
+}
+inline void xl_str_matcher::distances(const xl_str_collection& xlstrs, size_t maxdist, ptrdiff_t *results) const {
+	if (this->blockcount == 1) {
+		unsigned long long pv, mv;
+		for (size_t i = 0; i < xlstrs.size(); i++) results[i] = this->distance(xlstrs[i](), maxdist, &pv, &mv);
+		return;
+	}
+	workspace ws;
+	this->distances(xlstrs, maxdist, results, ws);
+}
+inline std::vector<ptrdiff_t> xl_str_matcher::distances(const xl_str_collection& xlstrs, size_t maxdist) const {
+	std::vector<ptrdiff_t> results(xlstrs.size());
+	this->distances(xlstrs, maxdist, results.data());
+	return results;
+}
+
+
+
+// Levenshtein distance between the current xlstr and str2, with the shorter str as the pattern so that fewer blocks are needed.
+inline ptrdiff_t xl_str::distance(const char *str2, size_t maxdist) const {
+	if (strlen(str2) <= strlen(this->str)) return xl_str_matcher(str2).distance(this->str, maxdist);
+	else return xl_str_matcher(this->str).distance(str2, maxdist);
+}
+inline ptrdiff_t xl_str::distance(const xl_str& xlstr2, size_t maxdist) const {
+	return this->distance(xlstr2(), maxdist);
+}
+inline size_t xl_str::distance(const char *str2) const {
+	return (size_t)this->distance(str2, (size_t)-1);
+}
+inline size_t xl_str::distance(const xl_str& xlstr2) const {
+	return (size_t)this->distance(xlstr2(), (size_t)-1);
+}
+
+// Approximate left-most index of substr in the current xlstr, with substr as the pattern.
+inline ptrdiff_t xl_str::fuzzy_indexof(const char *substr, size_t maxdist) const {
+	return xl_str_matcher(substr).fuzzy_indexof(this->str, maxdist);
+}
+inline ptrdiff_t xl_str::fuzzy_indexof(const xl_str& xlsubstr, size_t maxdist) const {
+	return this->fuzzy_indexof(xlsubstr(), maxdist);
+}
+
+
+
+// Writes the collection to path in the format read by xl_str_mapped_collection, with a checksum unless checksum is false.
+// The header is written with a zero checksum first and rewritten once the offsets and blob have been hashed. Returns false if the file cannot be written.
+inline bool xl_str_collection::save(const char *path, bool checksum) const {
+	size_t count = this->size();
+	std::vector<uint64_t> offsets(count + 1);
+	offsets[0] = 0;
+	for (size_t i = 0; i < count; i++) offsets[i + 1] = offsets[i] + (*this)[i].size() + 1;
+	xl_str_mapped_collection::header hdr;
+	memcpy(hdr.magic, "XLSTRCOL", 8);
+	hdr.version = xl_str_mapped_collection::formatversion;
+	hdr.flags = checksum ? xl_str_mapped_collection::checksumflag : 0;
+	hdr.count = count;
+	hdr.blobsize = offsets[count];
+	hdr.checksum = 0;
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr) return false;
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, file) == 1;
+	ok = ok && fwrite(offsets.data(), sizeof(uint64_t), count + 1, file) == count + 1;
+	uint64_t hash = checksum ? xl_file_map::fnv1a(offsets.data(), sizeof(uint64_t) * (count + 1)) : 0;
+	for (size_t i = 0; ok && i < count; i++) {
+		size_t memcount = (size_t)(offsets[i + 1] - offsets[i]);
+		ok = fwrite((*this)[i](), sizeof(char), memcount, file) == memcount;
+		if (checksum) hash = xl_file_map::fnv1a((*this)[i](), memcount, hash);
+	}
+	if (ok && checksum) {
+		hdr.checksum = hash;
+		ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, file) == 1;
+	}
+	ok = (fclose(file) == 0) && ok;
+	return ok;
+}